@@ -0,0 +1,20 @@
+/*
+ * Copyright (C) 2015 Freescale Semiconductor, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __DT_BINDINGS_IMX7_POWER_H__
+#define __DT_BINDINGS_IMX7_POWER_H__
+
+/* Power domain IDs of the fsl,imx7d-gpc power domain provider */
+#define IMX7_POWER_DOMAIN_MIPI_PHY		0
+#define IMX7_POWER_DOMAIN_PCIE_PHY		1
+#define IMX7_POWER_DOMAIN_USB_HSIC_PHY		2
+#define IMX7_POWER_DOMAIN_USB_OTG1_PHY		3
+#define IMX7_POWER_DOMAIN_USB_OTG2_PHY		4
+#define IMX7_POWER_DOMAIN_FAST_MEGA_MIX		5
+
+#endif
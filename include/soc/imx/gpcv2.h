@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015 Freescale Semiconductor, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __SOC_IMX_GPCV2_H__
+#define __SOC_IMX_GPCV2_H__
+
+#include <linux/types.h>
+
+struct clk;
+
+/*
+ * Peripherals inside the Fast/Mega MIX power domain lose their register
+ * contents when the domain is gated in suspend. Instead of re-probing
+ * their hardware on resume, drivers can register a contiguous register
+ * block here: it is saved to DDR right before the domain goes down and
+ * written back in one pass when the system resumes.
+ *
+ * If @clk is given, it must already be prepared; it is enabled around
+ * the save and restore accesses only. @num is limited to
+ * GPCV2_MIX_SAVE_MAX_NUM registers.
+ */
+#define GPCV2_MIX_SAVE_MAX_NUM	1024
+
+#if defined(CONFIG_SOC_IMX7D) && defined(CONFIG_SUSPEND)
+int imx_gpcv2_mix_save_register(void __iomem *base, u32 num, struct clk *clk);
+void imx_gpcv2_mix_save_unregister(void __iomem *base);
+#else
+static inline int imx_gpcv2_mix_save_register(void __iomem *base, u32 num,
+					      struct clk *clk)
+{
+	return 0;
+}
+static inline void imx_gpcv2_mix_save_unregister(void __iomem *base) {}
+#endif
+
+#endif
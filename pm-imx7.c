@@ -6,14 +6,27 @@
  * published by the Free Software Foundation.
  */
 
+#include <linux/alarmtimer.h>
+#include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/interrupt.h>
+#include <linux/irqdomain.h>
 #include <linux/mfd/syscon.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
+#include <linux/platform_device.h>
+#include <linux/pm_domain.h>
 #include <linux/regmap.h>
+#include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
+#include <asm/arch_timer.h>
 #include <asm/suspend.h>
 #include <asm/fncpy.h>
+#include <dt-bindings/power/imx7-power.h>
+#include <soc/imx/gpcv2.h>
+#include <trace/events/irq.h>
 
 #include "common.h"
 
@@ -23,10 +36,12 @@
 
 #define GPC_SLPCR		0x14
 #define GPC_PGC_ACK_SEL_A7	0x24
+#define GPC_ISRx_A7(x)		(0x70 + 4 * (x))
 
 #define GPC_SLOTx_CFG(x) 	(0xb0 + 4 * (x))
 
 #define GPC_PGC_CPU_MAPPING	0xec
+#define BM_GPC_PGC_MAP_A7_PHY(i)	(1 << (2 + (i)))
 
 #define GPC_PGC_C0		0x800
 #define GPC_PGC_C1		0x840
@@ -73,12 +88,15 @@
 #define BM_GPC_PGC_ACK_SEL_A7_DUMMY_PUP		(0x1 << 31)
 #define BM_GPC_PGC_ACK_SEL_A7_DUMMY_PDN		(0x1 << 15)
 
+#define BM_GPC_PGC_PCR				(0x1)
+
 #define BM_ANADIG_ARM_PLL_OVERRIDE		(0x1 << 20)
 #define BM_ANADIG_DDR_PLL_OVERRIDE		(0x1 << 19)
 #define BM_ANADIG_SYS_PLL_PFDx_OVERRIDE		(0x1FF << 17)
 #define BM_ANADIG_ENET_PLL_OVERRIDE		(0x1 << 13)
 #define BM_ANADIG_AUDIO_PLL_OVERRIDE		(0x1 << 24)
 #define BM_ANADIG_VIDEO_PLL_OVERRIDE		(0x1 << 24)
+#define BM_ANADIG_PLL_LOCK			(0x1 << 31)
 
 #define A7_LPM_WAIT		0x5
 #define A7_LPM_STOP		0xa
@@ -88,11 +106,46 @@
 #define REG_CLR			0x8
 
 #define MX7_MAX_DDRC_NUM		32
-#define MX7_MAX_DDRC_PHY_NUM		16
+#define MX7_MAX_DDRC_PHY_NUM		32
 
 #define READ_DATA_FROM_HARDWARE		0
+
+#define DDRC_MSTR			0x0
+#define BM_DDRC_MSTR_DDR3		(0x1 << 0)
+#define BM_DDRC_MSTR_LPDDR3		(0x1 << 3)
+
+/* must match the values checked in suspend-imx7.S */
+#define MX7_DDR_TYPE_DDR3		0
+#define MX7_DDR_TYPE_LPDDR3		1
 #define MX7_SUSPEND_OCRAM_SIZE		0x1000
 
+#define L2_AUTO_THRESHOLD_MS		1000
+#define L2_PROBE_SIZE			(256 * 1024)
+#define L2_PROBE_STRIDE			64
+#define PLL_AUTO_THRESHOLD_MS		1000
+#define PLL_LOCK_TIMEOUT_US		1000
+
+/*
+ * L2 cache RAM handling in suspend: power it down with the SCU, keep it
+ * in retention, or retain it only when the armed RTC alarm is due in
+ * less than l2_threshold_ms.
+ */
+enum gpcv2_l2_policy {
+	GPC_L2_POWER_DOWN,
+	GPC_L2_RETAIN,
+	GPC_L2_AUTO,
+};
+
+enum gpcv2_pll {
+	GPC_PLL_ARM,
+	GPC_PLL_DDR,
+	GPC_PLL_SYS,
+	GPC_PLL_ENET,
+	GPC_PLL_AUDIO,
+	GPC_PLL_VIDEO,
+	GPC_PLL_NUM,
+};
+
 enum gpcv2_mode {
 	GPC_WAIT_CLOCKED,
 	GPC_WAIT_UNCLOCKED,
@@ -128,8 +181,55 @@ enum gpcv2_slot {
 	CORE0_M4,
 };
 
+#define GPC_PHY_NUM		(USB_HSIC_PHY - MIPI_PHY + 1)
+
+#define GPC_WAKE_SRC_NUM	8
+#define GPC_WAKE_HIST_NUM	16
+#define GPC_WAKE_CHAIN_NUM	16
+
 struct imx_gpcv2;
 
+/*
+ * A PLL whose override bits hand its power control to the GPC in low
+ * power mode. consumers lists the compatibles of the devices clocked by
+ * it; the PLL may be kept locked while one of them is a wakeup source.
+ */
+struct imx_gpcv2_pll {
+	const char *name;
+	u32 offset;
+	u32 override;
+	const char * const *consumers;
+};
+
+struct imx_gpcv2_pll_stat {
+	u32 kept;
+	/* counter ticks spent in low power mode while kept locked */
+	u64 kept_ticks_total;
+	u32 relocked;
+	u32 relock_ticks_last;
+	u32 relock_ticks_max;
+	u64 relock_ticks_total;
+};
+
+/*
+ * Wake-to-handler latency of one wakeup source. hist[0] counts wakeups
+ * below 1 us, hist[n] those in [2^(n-1), 2^n) us, the last bucket is
+ * open ended. path[] splits them by wfi fall-through and SRC vector.
+ */
+struct imx_gpcv2_wake_stat {
+	u32 hwirq;
+	char name[16];
+	u32 path[2];
+	u32 max_us;
+	u32 hist[GPC_WAKE_HIST_NUM];
+};
+
+/* irq domain of a controller chained behind GPC interrupt @hwirq */
+struct imx_gpcv2_wake_chain {
+	u32 hwirq;
+	struct irq_domain *domain;
+};
+
 struct imx_gpcv2_suspend {
 	void (*set_mode)(struct imx_gpcv2 *, enum gpcv2_mode mode);
 	void (*lpm_cpu_power_gate)(struct imx_gpcv2 *, u32, bool);
@@ -145,26 +245,106 @@ struct imx_gpcv2_suspend {
 	void (*lpm_enable_core)(struct imx_gpcv2 *,
 			bool enable, u32 offset);
 
+	void (*mix_save)(struct imx_gpcv2 *);
+	void (*mix_restore)(struct imx_gpcv2 *);
+
 	void (*standby)(struct imx_gpcv2 *);
 	void (*suspend)(struct imx_gpcv2 *);
 
 	void (*suspend_fn_in_ocram)(void __iomem *ocram_vbase);
 	void __iomem *ocram_vbase;
+	bool ocram_ready;
+	u32 flush_mode;
 };
 
 struct imx_gpcv2 {
 	u32 *wakeupmix_mask;
 	u32 *lpsrmix_mask;
 	u32 *mfmix_mask;
+	/* wakeup sources behind each PHY domain, indexed from MIPI_PHY */
+	u32 *phy_mask[GPC_PHY_NUM];
+	/* generic PM domain of each PHY domain, NULL if it has none */
+	struct generic_pm_domain *phy_genpd[GPC_PHY_NUM];
+	u32 phy_gated;
+	u32 pgc_mapping;
+	u32 mask_num;
+	bool mfmix_from_dt;
+	/* a driver was (un)bound, rebuild the masks before suspend */
+	bool masks_stale;
 	spinlock_t lock;
+	struct notifier_block bus_nb;
 
 	struct imx_gpcv2_suspend *pm;
 	struct regmap *anatop;
 	struct regmap *gpcv2;
+	struct dentry *debugfs;
+
+	u32 l2_policy;
+	u32 l2_threshold_ms;
+	bool l2_retain;
+
+	/* time to the armed RTC alarm, U32_MAX if none */
+	u32 next_wakeup_ms;
+
+	/*
+	 * Cost of a fixed read loop over l2_probe_buf right after resume,
+	 * [0] L2 powered down, [1] L2 retained
+	 */
+	u32 l2_measure;
+	u32 *l2_probe_buf;
+	u32 l2_probe_count[2];
+	u64 l2_probe_ticks[2];
+
+	/*
+	 * PLLs kept locked in low power mode, as GPC_PLL_* bits: always
+	 * kept, kept on short sleeps when a consumer is a wakeup source,
+	 * the resulting set for the current cycle and those which were
+	 * locked before being handed to the GPC.
+	 */
+	u32 pll_keep;
+	u32 pll_auto;
+	u32 pll_kept;
+	u32 pll_locked;
+	u32 pll_threshold_ms;
+	u32 pll_measure;
+	u64 pll_stamp;
+	struct imx_gpcv2_pll_stat pll_stat[GPC_PLL_NUM];
+
+	/*
+	 * Wakeup currently being timed: the GPC interrupt reported pending
+	 * on resume, its Linux irq (0 when idle) and the physical counter
+	 * value captured by the OCRAM code as the core woke up.
+	 */
+	u32 wake_measure;
+	bool wake_probe;
+	struct irq_domain *wake_domain;
+	u32 wake_hwirq;
+	unsigned int wake_irq;
+	u32 wake_path;
+	u64 wake_ticks;
+	u32 wake_unmatched;
+	struct imx_gpcv2_wake_stat wake_stat[GPC_WAKE_SRC_NUM];
+
+	/* chained controllers, and the one behind the current wakeup */
+	struct imx_gpcv2_wake_chain wake_chain[GPC_WAKE_CHAIN_NUM];
+	u32 wake_chain_num;
+	struct irq_domain *wake_child;
 
 	u32 (*get_wakeup_source)(u32 **);
 };
 
+/*
+ * Register block of a Fast/Mega MIX peripheral, saved before the MIX
+ * is gated and restored on resume.
+ */
+struct imx_gpcv2_mix_range {
+	struct list_head node;
+	void __iomem *base;
+	struct clk *clk;
+	u32 num;
+	u32 *val;
+};
+
 struct imx7_pm_base {
 	phys_addr_t pbase;
 	void __iomem *vbase;
@@ -228,10 +408,33 @@ struct imx7_cpu_pm_info {
 	u32 ddrc_phy_num;
 
 	/* To save offset and value */
-	u32 ddrc_phy_val[MX7_MAX_DDRC_NUM][2];
+	u32 ddrc_phy_val[MX7_MAX_DDRC_PHY_NUM][2];
+
+	/* Cache flush sequence on suspend entry, 1 selects the legacy one */
+	u32 flush_mode;
+
+	/* Generic timer ticks spent flushing caches in the last entry */
+	u32 flush_ticks;
+
+	/* Physical counter at the first instruction run on wakeup */
+	u32 wake_ticks_lo;
+	u32 wake_ticks_hi;
+
+	/* 1 if the core resumed through the SRC vector, 0 if wfi returned */
+	u32 wake_path;
+
+	/*
+	 * PLLs whose LOCK is timed from the wake timestamp, as ANATOP
+	 * offsets. Each result is in generic timer ticks, U32_MAX if the
+	 * PLL did not lock within pll_timeout ticks.
+	 */
+	u32 pll_num;
+	u32 pll_timeout;
+	u32 pll_offset[GPC_PLL_NUM];
+	u32 pll_lock_ticks[GPC_PLL_NUM];
 } __aligned(8);
 
-static const u32 imx7d_ddrc_ddr3_setting[][2] __initconst = {
+static const u32 imx7d_ddrc_ddr3_setting[][2] = {
 	{ 0x0, READ_DATA_FROM_HARDWARE },
 	{ 0x1a0, READ_DATA_FROM_HARDWARE },
 	{ 0x1a4, READ_DATA_FROM_HARDWARE },
@@ -262,7 +465,7 @@ static const u32 imx7d_ddrc_ddr3_setting[][2] __initconst = {
 	{ 0x244, READ_DATA_FROM_HARDWARE },
 };
 
-static const u32 imx7d_ddrc_phy_ddr3_setting[][2] __initconst = {
+static const u32 imx7d_ddrc_phy_ddr3_setting[][2] = {
 	{ 0x0, READ_DATA_FROM_HARDWARE },
 	{ 0x4, READ_DATA_FROM_HARDWARE },
 	{ 0x10, READ_DATA_FROM_HARDWARE },
@@ -278,7 +481,64 @@ static const u32 imx7d_ddrc_phy_ddr3_setting[][2] __initconst = {
 	{ 0xc0, 0x0e407306 },
 };
 
-static const struct imx7_pm_socdata imx7d_pm_data_ddr3 __initconst = {
+static const u32 imx7d_ddrc_lpddr3_setting[][2] = {
+	{ 0x0, READ_DATA_FROM_HARDWARE },
+	{ 0x1a0, READ_DATA_FROM_HARDWARE },
+	{ 0x1a4, READ_DATA_FROM_HARDWARE },
+	{ 0x1a8, READ_DATA_FROM_HARDWARE },
+	{ 0x64, READ_DATA_FROM_HARDWARE },
+	{ 0x490, 0x00000001 },
+	{ 0xd0, 0xc0020001 },
+	{ 0xd4, READ_DATA_FROM_HARDWARE },
+	{ 0xdc, READ_DATA_FROM_HARDWARE },
+	{ 0xe0, READ_DATA_FROM_HARDWARE },
+	{ 0xe4, READ_DATA_FROM_HARDWARE },
+	{ 0xf4, READ_DATA_FROM_HARDWARE },
+	{ 0x100, READ_DATA_FROM_HARDWARE },
+	{ 0x104, READ_DATA_FROM_HARDWARE },
+	{ 0x108, READ_DATA_FROM_HARDWARE },
+	{ 0x10c, READ_DATA_FROM_HARDWARE },
+	{ 0x110, READ_DATA_FROM_HARDWARE },
+	{ 0x114, READ_DATA_FROM_HARDWARE },
+	{ 0x118, READ_DATA_FROM_HARDWARE },
+	{ 0x120, READ_DATA_FROM_HARDWARE },
+	{ 0x180, READ_DATA_FROM_HARDWARE },
+	{ 0x184, READ_DATA_FROM_HARDWARE },
+	{ 0x190, READ_DATA_FROM_HARDWARE },
+	{ 0x194, READ_DATA_FROM_HARDWARE },
+	{ 0x200, READ_DATA_FROM_HARDWARE },
+	{ 0x204, READ_DATA_FROM_HARDWARE },
+	{ 0x214, READ_DATA_FROM_HARDWARE },
+	{ 0x218, READ_DATA_FROM_HARDWARE },
+	{ 0x240, 0x06000601 },
+	{ 0x244, READ_DATA_FROM_HARDWARE },
+};
+
+static const u32 imx7d_ddrc_phy_lpddr3_setting[][2] = {
+	{ 0x0, READ_DATA_FROM_HARDWARE },
+	{ 0x4, READ_DATA_FROM_HARDWARE },
+	{ 0x8, READ_DATA_FROM_HARDWARE },
+	{ 0x10, READ_DATA_FROM_HARDWARE },
+	{ 0xb0, READ_DATA_FROM_HARDWARE },
+	{ 0x1c, READ_DATA_FROM_HARDWARE },
+	{ 0x9c, READ_DATA_FROM_HARDWARE },
+	{ 0x7c, READ_DATA_FROM_HARDWARE },
+	{ 0x80, READ_DATA_FROM_HARDWARE },
+	{ 0x84, READ_DATA_FROM_HARDWARE },
+	{ 0x88, READ_DATA_FROM_HARDWARE },
+	{ 0x6c, READ_DATA_FROM_HARDWARE },
+	{ 0x20, READ_DATA_FROM_HARDWARE },
+	{ 0x30, READ_DATA_FROM_HARDWARE },
+	{ 0x50, 0x01000008 },
+	{ 0x50, 0x00000008 },
+	{ 0xc0, 0x0e487304 },
+	{ 0xc0, 0x0e4c7304 },
+	/* ZQ calibration start, completed in suspend-imx7.S */
+	{ 0xc0, 0x0e4c7306 },
+};
+
+static const struct imx7_pm_socdata imx7d_pm_data_ddr3 = {
+	.ddr_type = MX7_DDR_TYPE_DDR3,
 	.iomuxc_gpr_compat = "fsl,imx7d-iomuxc",
 	.ddrc_phy_compat = "fsl,imx7d-ddrc-phy",
 	.anatop_compat = "fsl,imx7d-anatop",
@@ -292,8 +552,143 @@ static const struct imx7_pm_socdata imx7d_pm_data_ddr3 __initconst = {
 	.ddrc_offset = imx7d_ddrc_ddr3_setting,
 };
 
+static const struct imx7_pm_socdata imx7d_pm_data_lpddr3 = {
+	.ddr_type = MX7_DDR_TYPE_LPDDR3,
+	.iomuxc_gpr_compat = "fsl,imx7d-iomuxc",
+	.ddrc_phy_compat = "fsl,imx7d-ddrc-phy",
+	.anatop_compat = "fsl,imx7d-anatop",
+	.ddrc_compat = "fsl,imx7d-ddrc",
+	.ccm_compat = "fsl,imx7d-ccm",
+	.gpc_compat = "fsl,imx7d-gpc",
+	.src_compat = "fsl,imx7d-src",
+	.ddrc_phy_num = ARRAY_SIZE(imx7d_ddrc_phy_lpddr3_setting),
+	.ddrc_phy_offset = imx7d_ddrc_phy_lpddr3_setting,
+	.ddrc_num = ARRAY_SIZE(imx7d_ddrc_lpddr3_setting),
+	.ddrc_offset = imx7d_ddrc_lpddr3_setting,
+};
+
+/* socdata per DDR type, indexed by MX7_DDR_TYPE_* */
+static const struct imx7_pm_socdata *imx7d_pm_data[] = {
+	[MX7_DDR_TYPE_DDR3] = &imx7d_pm_data_ddr3,
+	[MX7_DDR_TYPE_LPDDR3] = &imx7d_pm_data_lpddr3,
+};
+
+static const struct of_device_id imx7_pm_ddrc_ids[] = {
+	{ .compatible = "fsl,imx7d-ddrc", .data = imx7d_pm_data, },
+	{ /* sentinel */ }
+};
+
+static const char * const imx7d_enet_pll_consumers[] = {
+	"fsl,imx7d-fec", "fsl,imx6sx-fec", NULL,
+};
+
+static const char * const imx7d_audio_pll_consumers[] = {
+	"fsl,imx7d-sai", "fsl,imx6sx-sai", NULL,
+};
+
+static const struct imx_gpcv2_pll imx7d_plls[GPC_PLL_NUM] = {
+	[GPC_PLL_ARM] = { "arm", ANADIG_ARM_PLL,
+		BM_ANADIG_ARM_PLL_OVERRIDE, NULL },
+	[GPC_PLL_DDR] = { "ddr", ANADIG_DDR_PLL,
+		BM_ANADIG_DDR_PLL_OVERRIDE, NULL },
+	[GPC_PLL_SYS] = { "sys", ANADIG_SYS_PLL,
+		BM_ANADIG_SYS_PLL_PFDx_OVERRIDE, NULL },
+	[GPC_PLL_ENET] = { "enet", ANADIG_ENET_PLL,
+		BM_ANADIG_ENET_PLL_OVERRIDE, imx7d_enet_pll_consumers },
+	[GPC_PLL_AUDIO] = { "audio", ANADIG_AUDIO_PLL,
+		BM_ANADIG_AUDIO_PLL_OVERRIDE, imx7d_audio_pll_consumers },
+	[GPC_PLL_VIDEO] = { "video", ANADIG_VIDEO_PLL,
+		BM_ANADIG_VIDEO_PLL_OVERRIDE, NULL },
+};
+
+static const u32 imx_gpcv2_phy_pgc[GPC_PHY_NUM] = {
+	GPC_PGC_MIPI_PHY,
+	GPC_PGC_PCIE_PHY,
+	GPC_PGC_USB_OTG1_PHY,
+	GPC_PGC_USB_OTG2_PHY,
+	GPC_PGC_USB_HSIC_PHY,
+};
+
 static struct imx_gpcv2 *gpcv2_instance;
 
+static LIST_HEAD(imx_gpcv2_mix_ranges);
+static DEFINE_SPINLOCK(imx_gpcv2_mix_lock);
+
+int imx_gpcv2_mix_save_register(void __iomem *base, u32 num, struct clk *clk)
+{
+	struct imx_gpcv2_mix_range *range;
+	unsigned long flags;
+
+	if (!base || !num || num > GPCV2_MIX_SAVE_MAX_NUM)
+		return -EINVAL;
+
+	range = kzalloc(sizeof(*range) + num * sizeof(u32), GFP_KERNEL);
+	if (!range)
+		return -ENOMEM;
+
+	range->base = base;
+	range->clk = clk;
+	range->num = num;
+	range->val = (u32 *)(range + 1);
+
+	spin_lock_irqsave(&imx_gpcv2_mix_lock, flags);
+	list_add_tail(&range->node, &imx_gpcv2_mix_ranges);
+	spin_unlock_irqrestore(&imx_gpcv2_mix_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(imx_gpcv2_mix_save_register);
+
+void imx_gpcv2_mix_save_unregister(void __iomem *base)
+{
+	struct imx_gpcv2_mix_range *range, *tmp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&imx_gpcv2_mix_lock, flags);
+	list_for_each_entry_safe(range, tmp, &imx_gpcv2_mix_ranges, node) {
+		if (range->base != base)
+			continue;
+		list_del(&range->node);
+		kfree(range);
+	}
+	spin_unlock_irqrestore(&imx_gpcv2_mix_lock, flags);
+}
+EXPORT_SYMBOL_GPL(imx_gpcv2_mix_save_unregister);
+
+static void imx_gpcv2_lpm_mix_save(struct imx_gpcv2 *gpc)
+{
+	struct imx_gpcv2_mix_range *range;
+	int i;
+
+	spin_lock(&imx_gpcv2_mix_lock);
+	list_for_each_entry(range, &imx_gpcv2_mix_ranges, node) {
+		if (range->clk)
+			clk_enable(range->clk);
+		for (i = 0; i < range->num; i++)
+			range->val[i] = readl_relaxed(range->base + i * 4);
+		if (range->clk)
+			clk_disable(range->clk);
+	}
+	spin_unlock(&imx_gpcv2_mix_lock);
+}
+
+static void imx_gpcv2_lpm_mix_restore(struct imx_gpcv2 *gpc)
+{
+	struct imx_gpcv2_mix_range *range;
+	int i;
+
+	spin_lock(&imx_gpcv2_mix_lock);
+	list_for_each_entry(range, &imx_gpcv2_mix_ranges, node) {
+		if (range->clk)
+			clk_enable(range->clk);
+		for (i = 0; i < range->num; i++)
+			writel_relaxed(range->val[i], range->base + i * 4);
+		if (range->clk)
+			clk_disable(range->clk);
+	}
+	spin_unlock(&imx_gpcv2_mix_lock);
+}
+
 static void imx_gpcv2_lpm_clear_slots(struct imx_gpcv2 *gpc)
 {
 	int i;
@@ -322,8 +717,10 @@ static void imx_gpcv2_lpm_slot_setup(struct imx_gpcv2 *gpc,
 		return;
 	}
 
+	/* a slot may sequence several domains at once */
 	val = (powerup ? 0x2 : 0x1) << (slot * 2);
-	regmap_write(gpc->gpcv2, GPC_SLOTx_CFG(index), val);
+	regmap_update_bits(gpc->gpcv2, GPC_SLOTx_CFG(index),
+			0x3 << (slot * 2), val);
 }
 
 static void imx_gpcv2_lpm_set_ack(struct imx_gpcv2 *gpc,
@@ -343,36 +740,103 @@ static void imx_gpcv2_lpm_set_ack(struct imx_gpcv2 *gpc,
 
 static void imx_gpcv2_lpm_env_setup(struct imx_gpcv2 *gpc)
 {
-	/* PLL and PFDs overwrite set */
-	regmap_write(gpc->anatop, ANADIG_ARM_PLL + REG_SET,
-			BM_ANADIG_ARM_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_DDR_PLL + REG_SET,
-			BM_ANADIG_DDR_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_SYS_PLL + REG_SET,
-			BM_ANADIG_SYS_PLL_PFDx_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_ENET_PLL + REG_SET,
-			BM_ANADIG_ENET_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_AUDIO_PLL + REG_SET,
-			BM_ANADIG_AUDIO_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_VIDEO_PLL + REG_SET,
-			BM_ANADIG_VIDEO_PLL_OVERRIDE);
+	struct imx7_cpu_pm_info *pm_info = gpc->pm->ocram_vbase;
+	const struct imx_gpcv2_pll *pll;
+	u32 val;
+	int i;
+
+	/* PLL and PFDs overwrite set, except for the PLLs kept locked */
+	gpc->pll_locked = 0;
+	gpc->pll_stamp = arch_counter_get_cntpct();
+	for (i = 0; i < GPC_PLL_NUM; i++) {
+		pll = &imx7d_plls[i];
+		if (gpc->pll_kept & BIT(i)) {
+			gpc->pll_stat[i].kept++;
+			continue;
+		}
+
+		regmap_read(gpc->anatop, pll->offset, &val);
+		if (val & BM_ANADIG_PLL_LOCK)
+			gpc->pll_locked |= BIT(i);
+		regmap_write(gpc->anatop, pll->offset + REG_SET,
+				pll->override);
+	}
+
+	if (!pm_info)
+		return;
+
+	/*
+	 * The GPC relocks the PLLs under override by itself on the way out
+	 * of STOP, so the OCRAM code times their LOCK from the very first
+	 * instruction run after wakeup, in the order of pll_locked.
+	 */
+	pm_info->pll_num = 0;
+	if (!gpc->pll_measure)
+		return;
+
+	pm_info->pll_timeout = div_u64((u64)arch_timer_get_rate() *
+				       PLL_LOCK_TIMEOUT_US, USEC_PER_SEC);
+	for (i = 0; i < GPC_PLL_NUM; i++) {
+		if (!(gpc->pll_locked & BIT(i)))
+			continue;
+		pm_info->pll_offset[pm_info->pll_num] = imx7d_plls[i].offset;
+		pm_info->pll_lock_ticks[pm_info->pll_num] = U32_MAX;
+		pm_info->pll_num++;
+	}
+}
+
+/*
+ * Account the LOCK times the OCRAM code took on wakeup. A PLL the GPC
+ * relocked before the core restarted reports close to 0: its relock
+ * is then part of the hardware wakeup latency rather than of resume.
+ */
+static void imx_gpcv2_lpm_account_relock(struct imx_gpcv2 *gpc)
+{
+	struct imx7_cpu_pm_info *pm_info = gpc->pm->ocram_vbase;
+	struct imx_gpcv2_pll_stat *stat;
+	u32 ticks;
+	int i, n = 0;
+
+	if (!pm_info)
+		return;
+
+	for (i = 0; i < GPC_PLL_NUM && n < pm_info->pll_num; i++) {
+		if (!(gpc->pll_locked & BIT(i)))
+			continue;
+
+		ticks = pm_info->pll_lock_ticks[n++];
+		if (ticks == U32_MAX) {
+			pr_warn("%s: %s PLL relock timeout\n", __func__,
+				imx7d_plls[i].name);
+			continue;
+		}
+
+		stat = &gpc->pll_stat[i];
+		stat->relocked++;
+		stat->relock_ticks_last = ticks;
+		stat->relock_ticks_max = max(stat->relock_ticks_max, ticks);
+		stat->relock_ticks_total += ticks;
+	}
+	pm_info->pll_num = 0;
 }
 
 static void imx_gpcv2_lpm_env_clean(struct imx_gpcv2 *gpc)
 {
+	u64 asleep = arch_counter_get_cntpct() - gpc->pll_stamp;
+	int i;
+
 	/* PLL and PFDs overwrite clear */
-	regmap_write(gpc->anatop, ANADIG_ARM_PLL + REG_CLR,
-			BM_ANADIG_ARM_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_DDR_PLL + REG_CLR,
-			BM_ANADIG_DDR_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_SYS_PLL + REG_CLR,
-			BM_ANADIG_SYS_PLL_PFDx_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_ENET_PLL + REG_CLR,
-			BM_ANADIG_ENET_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_AUDIO_PLL + REG_CLR,
-			BM_ANADIG_AUDIO_PLL_OVERRIDE);
-	regmap_write(gpc->anatop, ANADIG_VIDEO_PLL + REG_CLR,
-			BM_ANADIG_VIDEO_PLL_OVERRIDE);
+	for (i = 0; i < GPC_PLL_NUM; i++) {
+		if (gpc->pll_kept & BIT(i)) {
+			gpc->pll_stat[i].kept_ticks_total += asleep;
+			continue;
+		}
+		regmap_write(gpc->anatop, imx7d_plls[i].offset + REG_CLR,
+				imx7d_plls[i].override);
+	}
+
+	if (gpc->pll_measure)
+		imx_gpcv2_lpm_account_relock(gpc);
 }
 
 static void imx_gpcv2_lpm_set_mode(struct imx_gpcv2 *gpc,
@@ -442,23 +906,178 @@ static void imx_lpm_plat_power_gate(struct imx_gpcv2 *gpc, bool engate)
 
 	regmap_read(gpc->gpcv2, GPC_LPCR_A7_AD, &val);
 	val &= ~(BM_LPCR_A7_AD_EN_PLAT_PDN | BM_LPCR_A7_AD_L2PGE);
-	if (engate)
-		val |= BM_LPCR_A7_AD_EN_PLAT_PDN | BM_LPCR_A7_AD_L2PGE;
+	if (engate) {
+		val |= BM_LPCR_A7_AD_EN_PLAT_PDN;
+		/* without L2PGE the L2 RAM stays in retention */
+		if (!gpc->l2_retain)
+			val |= BM_LPCR_A7_AD_L2PGE;
+	}
 
 	regmap_write(gpc->gpcv2, GPC_LPCR_A7_AD, val);
 }
 
+static void imx_gpcv2_enter_ocram(struct imx_gpcv2_suspend *pm)
+{
+	struct imx7_cpu_pm_info *pm_info = pm->ocram_vbase;
+
+	pm_info->flush_mode = pm->flush_mode;
+	pm_info->wake_ticks_lo = 0;
+	pm_info->wake_ticks_hi = 0;
+	local_flush_tlb_all();
+	pm->suspend_fn_in_ocram(pm->ocram_vbase);
+}
+
+/*
+ * Called with interrupts still off after the OCRAM code returned: take
+ * the first enabled wakeup source the GPC reports pending and arm the
+ * irq_handler_entry probe for it.
+ */
+static void imx_gpcv2_wake_record(struct imx_gpcv2 *gpc)
+{
+	struct imx7_cpu_pm_info *pm_info = gpc->pm->ocram_vbase;
+	u32 *sources, isr = 0;
+	int i, num;
+
+	gpc->wake_irq = 0;
+	gpc->wake_child = NULL;
+	if (!gpc->wake_probe || !pm_info)
+		return;
+
+	gpc->wake_ticks = (u64)pm_info->wake_ticks_hi << 32 |
+			  pm_info->wake_ticks_lo;
+	if (!gpc->wake_ticks)
+		return;
+
+	num = gpc->get_wakeup_source(&sources);
+	for (i = 0; i < num; i++) {
+		regmap_read(gpc->gpcv2, GPC_ISRx_A7(i), &isr);
+		isr &= ~sources[i];
+		if (isr)
+			break;
+	}
+
+	if (!isr) {
+		gpc->wake_unmatched++;
+		return;
+	}
+
+	gpc->wake_hwirq = i * 32 + __ffs(isr);
+	gpc->wake_path = !!pm_info->wake_path;
+	gpc->wake_irq = irq_find_mapping(gpc->wake_domain, gpc->wake_hwirq);
+	if (!gpc->wake_irq) {
+		gpc->wake_unmatched++;
+		return;
+	}
+
+	for (i = 0; i < gpc->wake_chain_num; i++)
+		if (gpc->wake_chain[i].hwirq == gpc->wake_hwirq)
+			gpc->wake_child = gpc->wake_chain[i].domain;
+}
+
+static bool imx_gpcv2_domain_has_wakeup(const u32 *mask,
+		const u32 *sources, int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (~sources[i] & mask[i])
+			return true;
+
+	return false;
+}
+
+/*
+ * A PHY domain is only powered down with the MIX when its consumers are
+ * known from DT, none of them is an enabled wakeup source and the
+ * domain is powered at all. An unknown consumer set keeps the domain
+ * powered.
+ *
+ * Whether the domain is powered is taken from its genpd, which is what
+ * switches it at runtime; a domain genpd has powered off is left to it.
+ * PGC_SR.PSR cannot be used for this: it is sticky, and a later power
+ * up does not clear it. A domain without a genpd is never switched at
+ * runtime, so with a consumer bound to a driver it is powered.
+ */
+static bool imx_gpcv2_phy_can_gate(struct imx_gpcv2 *gpc, int phy,
+		const u32 *sources, int num)
+{
+	struct generic_pm_domain *genpd = gpc->phy_genpd[phy];
+	u32 *mask = gpc->phy_mask[phy];
+	u32 known = 0;
+	int i;
+
+	for (i = 0; i < gpc->mask_num; i++)
+		known |= mask[i];
+	if (!known || imx_gpcv2_domain_has_wakeup(mask, sources, num))
+		return false;
+
+	return !genpd || genpd->status == GPD_STATE_ACTIVE;
+}
+
+static bool imx_gpcv2_l2_should_retain(struct imx_gpcv2 *gpc)
+{
+	switch (gpc->l2_policy) {
+	case GPC_L2_RETAIN:
+		return true;
+	case GPC_L2_AUTO:
+		return gpc->next_wakeup_ms < gpc->l2_threshold_ms;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Read one word per cache line of a buffer that fits in L2. Run once
+ * before suspend to fill L2, and timed after resume: with L2 retained
+ * the lines still hit, with L2 powered down they all come from DDR.
+ */
+static void imx_gpcv2_l2_probe(const u32 *buf)
+{
+	int i;
+
+	for (i = 0; i < L2_PROBE_SIZE / sizeof(u32);
+	     i += L2_PROBE_STRIDE / sizeof(u32))
+		READ_ONCE(buf[i]);
+}
+
 static void imx_gpcv2_lpm_standby(struct imx_gpcv2 *gpc)
 {
 	struct imx_gpcv2_suspend *pm = gpc->pm;
 
 	pm->lpm_env_setup(gpc);
-	/* pm->set_mode(gpc, GPC_STOP_POWER_OFF); */
-	pm->set_mode(gpc, GPC_WAIT_UNCLOCKED);
+
+	/*
+	 * Without the OCRAM code DDR cannot be put into self-refresh, so
+	 * the GPC must not be allowed to stop the DDR PLL: fall back to
+	 * WAIT with the clocks gated, which leaves all PLLs running.
+	 */
+	if (!pm->suspend_fn_in_ocram) {
+		pm->set_mode(gpc, GPC_WAIT_UNCLOCKED);
+
+		/* Zzz ... */
+		cpu_do_idle();
+
+		pm->set_mode(gpc, GPC_WAIT_CLOCKED);
+		pm->lpm_env_clean(gpc);
+		return;
+	}
+
+	/*
+	 * STOP with power on: the PLLs are under override and DDR goes
+	 * into self-refresh from the OCRAM code, but neither the cores,
+	 * the SCU/L2 nor the Mega/Fast MIX are powered down. There is no
+	 * context to lose, so wfi simply falls through on wakeup and only
+	 * L1 is flushed (L2PGE is clear).
+	 */
+	pm->set_mode(gpc, GPC_STOP_POWER_ON);
+	pm->lpm_cpu_power_gate(gpc, 0, false);
+	pm->lpm_plat_power_gate(gpc, false);
+	pm->lpm_enable_core(gpc, false, GPC_PGC_FM);
 
 	/* Zzz ... */
-	cpu_do_idle();
+	imx_gpcv2_enter_ocram(pm);
 
+	imx_gpcv2_wake_record(gpc);
 	pm->set_mode(gpc, GPC_WAIT_CLOCKED);
 	pm->lpm_env_clean(gpc);
 }
@@ -474,8 +1093,7 @@ static int gpcv2_suspend_finish(unsigned long val)
 		 * call low level suspend function in ocram,
 		 * as we need to float DDR IO.
 		 */
-		local_flush_tlb_all();
-		pm->suspend_fn_in_ocram(pm->ocram_vbase);
+		imx_gpcv2_enter_ocram(pm);
 	}
 
 	return 0;
@@ -484,7 +1102,9 @@ static int gpcv2_suspend_finish(unsigned long val)
 static void imx_gpcv2_lpm_suspend(struct imx_gpcv2 *gpc)
 {
 	struct imx_gpcv2_suspend *pm = gpc->pm;
-	u32 *sources;
+	u32 *sources, *probe, val;
+	bool mix_gated;
+	u64 start;
 	int i, num;
 
 	pm->lpm_env_setup(gpc);
@@ -494,6 +1114,7 @@ static void imx_gpcv2_lpm_suspend(struct imx_gpcv2 *gpc)
 	pm->lpm_cpu_power_gate(gpc, 0, true);
 
 	/* enable plat power down with low power mode */
+	gpc->l2_retain = imx_gpcv2_l2_should_retain(gpc);
 	pm->lpm_plat_power_gate(gpc, true);
 
 	/*
@@ -502,28 +1123,45 @@ static void imx_gpcv2_lpm_suspend(struct imx_gpcv2 *gpc)
 	 *
 	 * Power down slot sequence:
 	 * Slot0 -> CORE0
-	 * Slot1 -> Mega/Fast MIX
+	 * Slot1 -> Mega/Fast MIX, unused PHYs
 	 * Slot2 -> SCU
 	 *
 	 * Power up slot sequence:
-	 * Slot5 -> Mega/Fast MIX
+	 * Slot5 -> Mega/Fast MIX, unused PHYs
 	 * Slot6 -> SCU
 	 * Slot7 -> CORE0
+	 *
+	 * The PHYs share the MIX slots, so they add no step to either
+	 * sequence and the acks stay on SCU and CORE0, the last domain
+	 * of each sequence.
 	 */
 	pm->set_slot(gpc, 0, CORE0_A7, false);
 	pm->set_slot(gpc, 2, SCU_A7, false);
 
+	gpc->phy_gated = 0;
 	if (gpc->get_wakeup_source) {
 		pm->set_slot(gpc, 1, FAST_MEGA_MIX, false);
 		pm->set_slot(gpc, 5, FAST_MEGA_MIX, true);
-		pm->lpm_enable_core(gpc, true, GPC_PGC_FM);
 		num = gpc->get_wakeup_source(&sources);
-		for (i = 0; i < num; i++) {
-			if ((~sources[i] & gpc->mfmix_mask[i]) == 0)
+		spin_lock(&gpc->lock);
+		if (!imx_gpcv2_domain_has_wakeup(gpc->mfmix_mask,
+						 sources, num))
+			pm->lpm_enable_core(gpc, true, GPC_PGC_FM);
+
+		regmap_read(gpc->gpcv2, GPC_PGC_CPU_MAPPING,
+			    &gpc->pgc_mapping);
+		for (i = 0; i < GPC_PHY_NUM; i++) {
+			if (!imx_gpcv2_phy_can_gate(gpc, i, sources, num))
 				continue;
-			pm->lpm_enable_core(gpc, false, GPC_PGC_FM);
-			break;
+			pm->set_slot(gpc, 1, MIPI_PHY + i, false);
+			pm->set_slot(gpc, 5, MIPI_PHY + i, true);
+			regmap_update_bits(gpc->gpcv2, GPC_PGC_CPU_MAPPING,
+				BM_GPC_PGC_MAP_A7_PHY(i),
+				BM_GPC_PGC_MAP_A7_PHY(i));
+			pm->lpm_enable_core(gpc, true, imx_gpcv2_phy_pgc[i]);
+			gpc->phy_gated |= BIT(i);
 		}
+		spin_unlock(&gpc->lock);
 	}
 
 	pm->set_slot(gpc, 6, SCU_A7, true);
@@ -539,8 +1177,33 @@ static void imx_gpcv2_lpm_suspend(struct imx_gpcv2 *gpc)
 	pm->lpm_enable_core(gpc, true, GPC_PGC_C0);
 	pm->lpm_enable_core(gpc, true, GPC_PGC_SCU);
 
+	/*
+	 * Only pay for the register save/restore if the Mega/Fast MIX
+	 * is really going to lose power in this suspend.
+	 */
+	regmap_read(gpc->gpcv2, GPC_PGC_FM, &val);
+	mix_gated = val & BM_GPC_PGC_PCR;
+	if (mix_gated)
+		pm->mix_save(gpc);
+
+	probe = gpc->l2_measure ? gpc->l2_probe_buf : NULL;
+	if (probe)
+		imx_gpcv2_l2_probe(probe);
+
 	cpu_suspend((unsigned long)pm, gpcv2_suspend_finish);
 
+	if (probe) {
+		start = arch_timer_read_counter();
+		imx_gpcv2_l2_probe(probe);
+		gpc->l2_probe_ticks[gpc->l2_retain] +=
+			arch_timer_read_counter() - start;
+		gpc->l2_probe_count[gpc->l2_retain]++;
+	}
+	imx_gpcv2_wake_record(gpc);
+
+	if (mix_gated)
+		pm->mix_restore(gpc);
+
 	pm->lpm_env_clean(gpc);
 	pm->set_mode(gpc, GPC_WAIT_CLOCKED);
 	pm->lpm_cpu_power_gate(gpc, 0, false);
@@ -549,6 +1212,14 @@ static void imx_gpcv2_lpm_suspend(struct imx_gpcv2 *gpc)
 	pm->lpm_enable_core(gpc, false, GPC_PGC_C0);
 	pm->lpm_enable_core(gpc, false, GPC_PGC_SCU);
 	pm->lpm_enable_core(gpc, false, GPC_PGC_FM);
+	for (i = 0; i < GPC_PHY_NUM; i++) {
+		if (!(gpc->phy_gated & BIT(i)))
+			continue;
+		pm->lpm_enable_core(gpc, false, imx_gpcv2_phy_pgc[i]);
+	}
+	if (gpc->phy_gated)
+		regmap_write(gpc->gpcv2, GPC_PGC_CPU_MAPPING,
+			     gpc->pgc_mapping);
 	pm->clear_slots(gpc);
 }
 
@@ -574,34 +1245,82 @@ static int imx_gpcv2_pm_enter(suspend_state_t state)
 	return 0;
 }
 
-static int imx_gpcv2_pm_valid(suspend_state_t state)
+static int imx_gpcv2_match_wakeup_consumer(struct device *dev, void *data)
 {
-	return state == PM_SUSPEND_MEM || state == PM_SUSPEND_STANDBY;
+	const char * const *compat;
+
+	if (!dev->of_node || !device_may_wakeup(dev))
+		return 0;
+
+	for (compat = data; *compat; compat++)
+		if (of_device_is_compatible(dev->of_node, *compat))
+			return 1;
+
+	return 0;
 }
 
-static int __init imx_get_base_from_node(struct device_node *node,
-			struct imx7_pm_base *base)
+/*
+ * Keeping a PLL locked costs its running current for the whole sleep but
+ * saves its relock on resume. That only pays off when the armed RTC
+ * alarm is due soon, and only if a device it clocks may wake the system
+ * up.
+ */
+static u32 imx_gpcv2_pll_policy(struct imx_gpcv2 *gpc)
 {
-	struct resource res;
-	int ret = 0;
+	const struct imx_gpcv2_pll *pll;
+	u32 kept = gpc->pll_keep;
+	int i;
 
-	ret = of_address_to_resource(node, 0, &res);
-	if (ret)
-		goto put_node;
-
-	base->pbase = res.start;
-	base->vbase = ioremap(res.start, resource_size(&res));
-	if (!base->vbase) {
-		iounmap(base->vbase);
-		ret = -ENOMEM;
+	if (gpc->next_wakeup_ms >= gpc->pll_threshold_ms)
+		return kept;
+
+	for (i = 0; i < GPC_PLL_NUM; i++) {
+		pll = &imx7d_plls[i];
+		if (!(gpc->pll_auto & BIT(i)) || !pll->consumers)
+			continue;
+		if (bus_for_each_dev(&platform_bus_type, NULL,
+				     (void *)pll->consumers,
+				     imx_gpcv2_match_wakeup_consumer))
+			kept |= BIT(i);
 	}
-put_node:
-	of_node_put(node);
 
-	return ret;
+	return kept;
+}
+
+/*
+ * Time to the alarm armed on the RTC used for wakeup, U32_MAX if there
+ * is none. Only the RTC alarm is known in advance, any other wakeup
+ * source counts as a long sleep.
+ */
+static u32 imx_gpcv2_next_wakeup_ms(void)
+{
+#ifdef CONFIG_RTC_CLASS
+	struct rtc_device *rtc = alarmtimer_get_rtcdev();
+	struct rtc_wkalrm alarm;
+	struct rtc_time tm;
+	time64_t now, when;
+
+	if (!rtc || rtc_read_time(rtc, &tm) ||
+	    rtc_read_alarm(rtc, &alarm) || !alarm.enabled)
+		return U32_MAX;
+
+	now = rtc_tm_to_time64(&tm);
+	when = rtc_tm_to_time64(&alarm.time);
+	if (when <= now)
+		return 0;
+
+	return min_t(time64_t, (when - now) * MSEC_PER_SEC, U32_MAX - 1);
+#else
+	return U32_MAX;
+#endif
 }
 
-static int __init imx_get_base_from_dt(struct imx7_pm_base *base,
+static int imx_gpcv2_pm_valid(suspend_state_t state)
+{
+	return state == PM_SUSPEND_MEM || state == PM_SUSPEND_STANDBY;
+}
+
+static int imx_get_base_from_dt(struct imx7_pm_base *base,
 				const char *compat)
 {
 	struct device_node *node;
@@ -629,7 +1348,7 @@ out:
 	return ret;
 }
 
-static int __init imx_get_exec_base_from_dt(struct imx7_pm_base *base,
+static int imx_get_exec_base_from_dt(struct imx7_pm_base *base,
 				const char *compat)
 {
 	struct device_node *node;
@@ -658,72 +1377,118 @@ out:
 	return ret;
 }
 
-static int __init imx_gpcv2_suspend_init(struct imx_gpcv2_suspend *pm,
-			const struct imx7_pm_socdata *socdata)
+/*
+ * Map the DDRC found in DT and pick the socdata for its SoC and for the
+ * DDR type the boot loader programmed into it. On failure nothing is
+ * left mapped.
+ */
+static const struct imx7_pm_socdata *imx_gpcv2_get_socdata(
+			struct imx7_pm_base *ddrc_base)
+{
+	const struct imx7_pm_socdata **socdata;
+	const struct of_device_id *match;
+	struct device_node *node;
+	struct resource res;
+	u32 mstr;
+	int ret;
+
+	node = of_find_matching_node_and_match(NULL, imx7_pm_ddrc_ids, &match);
+	if (!node) {
+		pr_warn("%s: failed to find ddrc node!\n", __func__);
+		return NULL;
+	}
+
+	ret = of_address_to_resource(node, 0, &res);
+	of_node_put(node);
+	if (ret)
+		return NULL;
+
+	ddrc_base->pbase = res.start;
+	ddrc_base->vbase = ioremap(res.start, resource_size(&res));
+	if (!ddrc_base->vbase) {
+		pr_warn("%s: failed to map ddrc!\n", __func__);
+		return NULL;
+	}
+
+	mstr = readl_relaxed(ddrc_base->vbase + DDRC_MSTR);
+
+	socdata = (const struct imx7_pm_socdata **)match->data;
+	if (mstr & BM_DDRC_MSTR_LPDDR3) {
+		if (IS_ENABLED(CONFIG_IMX7_PM_LPDDR3))
+			return socdata[MX7_DDR_TYPE_LPDDR3];
+		pr_warn("%s: LPDDR3 retention is not enabled (CONFIG_IMX7_PM_LPDDR3)!\n",
+			__func__);
+	} else if (mstr & BM_DDRC_MSTR_DDR3) {
+		return socdata[MX7_DDR_TYPE_DDR3];
+	} else {
+		pr_warn("%s: unsupported DDR type, MSTR 0x%x!\n",
+			__func__, mstr);
+	}
+
+	iounmap(ddrc_base->vbase);
+	ddrc_base->vbase = NULL;
+	return NULL;
+}
+
+/*
+ * Set up the OCRAM suspend code and the DDRC/PHY snapshot it restores.
+ * Nothing of this is needed before the first suspend, so it is done
+ * from the .begin callback rather than on the boot path.
+ */
+static int imx_gpcv2_suspend_init(struct imx_gpcv2_suspend *pm)
 {
-	struct imx7_pm_base aips_base[3] = { {0, 0}, {0, 0}, {0, 0} };
+	const struct imx7_pm_socdata *socdata;
 	struct imx7_pm_base sram_base = {0, 0};
 	struct imx7_cpu_pm_info *pm_info;
-	struct device_node *node = NULL;
 	int i, ret = 0;
 
 	const u32 (*ddrc_phy_offset_array)[2];
 	const u32 (*ddrc_offset_array)[2];
 
-	if (!socdata || !pm) {
+	if (!pm) {
 		pr_warn("%s: invalid argument!\n", __func__);
 		return -EINVAL;
 	}
 
-	for (i = 0; i < 3; i++) {
-		node = of_find_compatible_node(node, NULL, "fsl,aips-bus");
-		if (!node) {
-			pr_warn("%s: failed to find aips %d node!\n",
-					__func__, i);
-			break;
-		}
-		ret = imx_get_base_from_node(node, &aips_base[i]);
-		if (ret) {
-			pr_warn("%s: failed to get aips[%d] base %d!\n",
-					__func__, i, ret);
-		}
-	}
-
 	ret = imx_get_exec_base_from_dt(&sram_base, "fsl,lpm-sram");
 	if (ret) {
 		pr_warn("%s: failed to get lpm-sram base %d!\n",
 				__func__, ret);
-		goto lpm_sram_map_failed;
+		return ret;
 	}
 
 	pm_info = sram_base.vbase;
+
+	socdata = imx_gpcv2_get_socdata(&pm_info->ddrc_base);
+	if (!socdata) {
+		ret = -ENODEV;
+		pr_warn("%s: failed to get ddrc base %d!\n", __func__, ret);
+		goto unmap_sram;
+	}
+
 	pm_info->pbase = sram_base.pbase;
 	pm_info->resume_addr = virt_to_phys(ca7_cpu_resume);
+	pm_info->ddr_type = socdata->ddr_type;
 	pm_info->pm_info_size = sizeof(*pm_info);
+	pm_info->flush_mode = 0;
 
 	ret = imx_get_base_from_dt(&pm_info->ccm_base, socdata->ccm_compat);
 	if (ret) {
 		pr_warn("%s: failed to get ccm base %d!\n", __func__, ret);
-		goto ccm_map_failed;
-	}
-
-	ret = imx_get_base_from_dt(&pm_info->ddrc_base, socdata->ddrc_compat);
-	if (ret) {
-		pr_warn("%s: failed to get ddrc base %d!\n", __func__, ret);
-		goto ddrc_map_failed;
+		goto unmap_ddrc;
 	}
 
 	ret = imx_get_base_from_dt(&pm_info->ddrc_phy_base,
 				socdata->ddrc_phy_compat);
 	if (ret) {
 		pr_warn("%s: failed to get ddrc_phy base %d!\n", __func__, ret);
-		goto ddrc_phy_map_failed;
+		goto unmap_ccm;
 	}
 
 	ret = imx_get_base_from_dt(&pm_info->src_base, socdata->src_compat);
 	if (ret) {
 		pr_warn("%s: failed to get src base %d!\n", __func__, ret);
-		goto src_map_failed;
+		goto unmap_ddrc_phy;
 	}
 
 	ret = imx_get_base_from_dt(&pm_info->iomuxc_gpr_base,
@@ -731,20 +1496,20 @@ static int __init imx_gpcv2_suspend_init(struct imx_gpcv2_suspend *pm,
 	if (ret) {
 		pr_warn("%s: failed to get iomuxc_gpr base %d!\n",
 					__func__, ret);
-		goto iomuxc_gpr_map_failed;
+		goto unmap_src;
 	}
 
 	ret = imx_get_base_from_dt(&pm_info->gpc_base, socdata->gpc_compat);
 	if (ret) {
 		pr_warn("%s: failed to get gpc base %d!\n", __func__, ret);
-		goto gpc_map_failed;
+		goto unmap_iomuxc_gpr;
 	}
 
 	ret = imx_get_base_from_dt(&pm_info->anatop_base,
 				socdata->anatop_compat);
 	if (ret) {
 		pr_warn("%s: failed to get anatop base %d!\n", __func__, ret);
-		goto anatop_map_failed;
+		goto unmap_gpc;
 	}
 
 	pm_info->ddrc_num = socdata->ddrc_num;
@@ -782,40 +1547,640 @@ static int __init imx_gpcv2_suspend_init(struct imx_gpcv2_suspend *pm,
 		MX7_SUSPEND_OCRAM_SIZE - sizeof(*pm_info));
 	pm->ocram_vbase = sram_base.vbase;
 
-	goto put_node;
+	return 0;
 
-anatop_map_failed:
-	iounmap(pm_info->anatop_base.vbase);
-gpc_map_failed:
+	/*
+	 * Each label undoes the mappings made before the failing one: the
+	 * base that failed was never mapped and still holds whatever was
+	 * left in OCRAM.
+	 */
+unmap_gpc:
 	iounmap(pm_info->gpc_base.vbase);
-iomuxc_gpr_map_failed:
+unmap_iomuxc_gpr:
 	iounmap(pm_info->iomuxc_gpr_base.vbase);
-src_map_failed:
+unmap_src:
 	iounmap(pm_info->src_base.vbase);
-ddrc_phy_map_failed:
+unmap_ddrc_phy:
 	iounmap(pm_info->ddrc_phy_base.vbase);
-ddrc_map_failed:
-	iounmap(pm_info->ddrc_base.vbase);
-ccm_map_failed:
+unmap_ccm:
 	iounmap(pm_info->ccm_base.vbase);
-lpm_sram_map_failed:
+unmap_ddrc:
+	iounmap(pm_info->ddrc_base.vbase);
+unmap_sram:
 	iounmap(sram_base.vbase);
-put_node:
-	of_node_put(node);
 
 	return ret;
 }
 
+static int imx_gpcv2_flush_stat_show(struct seq_file *m, void *unused)
+{
+	struct imx_gpcv2_suspend *pm = m->private;
+	struct imx7_cpu_pm_info *pm_info = pm->ocram_vbase;
+	u32 rate = arch_timer_get_rate();
+	u32 ticks;
+
+	seq_printf(m, "mode:\t%s\n",
+		   pm->flush_mode ? "legacy" : "single-pass");
+	if (!pm_info)
+		return 0;
+
+	ticks = pm_info->flush_ticks;
+	seq_printf(m, "ticks:\t%u\n", ticks);
+	if (rate)
+		seq_printf(m, "ns:\t%llu\n",
+			   div_u64((u64)ticks * NSEC_PER_SEC, rate));
+
+	return 0;
+}
+
+static int imx_gpcv2_flush_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, imx_gpcv2_flush_stat_show, inode->i_private);
+}
+
+static const struct file_operations imx_gpcv2_flush_stat_fops = {
+	.open = imx_gpcv2_flush_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int imx_gpcv2_l2_stat_show(struct seq_file *m, void *unused)
+{
+	struct imx_gpcv2 *gpc = m->private;
+	static const char * const name[] = { "powered down", "retained" };
+	u32 rate = arch_timer_get_rate();
+	int i;
+
+	seq_printf(m, "next wakeup:\t%u ms\n", gpc->next_wakeup_ms);
+	for (i = 0; i < ARRAY_SIZE(name); i++) {
+		u64 avg = 0;
+
+		if (gpc->l2_probe_count[i] && rate)
+			avg = div_u64(div_u64(gpc->l2_probe_ticks[i] *
+					      NSEC_PER_SEC, rate),
+				      gpc->l2_probe_count[i]);
+		seq_printf(m, "L2 %s:\t%u resumes, avg %llu ns per %u KiB probe\n",
+			   name[i], gpc->l2_probe_count[i], avg,
+			   L2_PROBE_SIZE / 1024);
+	}
+
+	return 0;
+}
+
+static int imx_gpcv2_l2_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, imx_gpcv2_l2_stat_show, inode->i_private);
+}
+
+static const struct file_operations imx_gpcv2_l2_stat_fops = {
+	.open = imx_gpcv2_l2_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int imx_gpcv2_pll_stat_show(struct seq_file *m, void *unused)
+{
+	struct imx_gpcv2 *gpc = m->private;
+	struct imx_gpcv2_pll_stat *stat;
+	u32 rate = arch_timer_get_rate() ?: 1;
+	u64 avg;
+	int i;
+
+	seq_puts(m, "pll\tpolicy\tkept\tkept ms\trelocked\tlast us\tmax us\tavg us\n");
+	for (i = 0; i < GPC_PLL_NUM; i++) {
+		stat = &gpc->pll_stat[i];
+		avg = stat->relocked ?
+			div_u64(stat->relock_ticks_total, stat->relocked) : 0;
+		seq_printf(m, "%s\t%s\t%u\t%llu\t%u\t\t%llu\t%llu\t%llu\n",
+			   imx7d_plls[i].name,
+			   gpc->pll_keep & BIT(i) ? "keep" :
+			   gpc->pll_auto & BIT(i) ? "auto" : "off",
+			   stat->kept,
+			   div_u64(stat->kept_ticks_total * MSEC_PER_SEC,
+				   rate),
+			   stat->relocked,
+			   div_u64((u64)stat->relock_ticks_last * USEC_PER_SEC,
+				   rate),
+			   div_u64((u64)stat->relock_ticks_max * USEC_PER_SEC,
+				   rate),
+			   div_u64(avg * USEC_PER_SEC, rate));
+	}
+
+	return 0;
+}
+
+static int imx_gpcv2_pll_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, imx_gpcv2_pll_stat_show, inode->i_private);
+}
+
+static const struct file_operations imx_gpcv2_pll_stat_fops = {
+	.open = imx_gpcv2_pll_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int imx_gpcv2_wake_latency_show(struct seq_file *m, void *unused)
+{
+	struct imx_gpcv2 *gpc = m->private;
+	struct imx_gpcv2_wake_stat *stat;
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&gpc->lock, flags);
+	seq_printf(m, "unmatched:\t%u\n", gpc->wake_unmatched);
+	for (i = 0; i < GPC_WAKE_SRC_NUM; i++) {
+		stat = &gpc->wake_stat[i];
+		if (!stat->path[0] && !stat->path[1])
+			break;
+
+		seq_printf(m, "%s (gpc irq %u):\t%u wfi, %u vector, max %u us\n",
+			   stat->name, stat->hwirq, stat->path[0],
+			   stat->path[1], stat->max_us);
+		for (j = 0; j < GPC_WAKE_HIST_NUM; j++) {
+			if (!stat->hist[j])
+				continue;
+			if (!j)
+				seq_puts(m, "\t< 1 us");
+			else if (j == GPC_WAKE_HIST_NUM - 1)
+				seq_printf(m, "\t>= %u us", 1 << (j - 1));
+			else
+				seq_printf(m, "\t%u - %u us", 1 << (j - 1),
+					   (1 << j) - 1);
+			seq_printf(m, ":\t%u\n", stat->hist[j]);
+		}
+	}
+	spin_unlock_irqrestore(&gpc->lock, flags);
+
+	return 0;
+}
+
+static int imx_gpcv2_wake_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, imx_gpcv2_wake_latency_show,
+			   inode->i_private);
+}
+
+static const struct file_operations imx_gpcv2_wake_latency_fops = {
+	.open = imx_gpcv2_wake_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void __init imx_gpcv2_debugfs_init(struct imx_gpcv2 *gpc)
+{
+	gpc->debugfs = debugfs_create_dir("imx_gpcv2", NULL);
+	if (!gpc->debugfs)
+		return;
+
+	/* 0: power down L2, 1: keep it in retention, 2: auto */
+	debugfs_create_u32("l2_policy", 0644, gpc->debugfs, &gpc->l2_policy);
+	debugfs_create_u32("l2_threshold_ms", 0644, gpc->debugfs,
+			   &gpc->l2_threshold_ms);
+	debugfs_create_u32("l2_measure", 0644, gpc->debugfs,
+			   &gpc->l2_measure);
+	debugfs_create_file("l2_stat", 0444, gpc->debugfs, gpc,
+			    &imx_gpcv2_l2_stat_fops);
+
+	/* PLL masks use the GPC_PLL_* bit numbers, see pll_stat */
+	debugfs_create_x32("pll_keep", 0644, gpc->debugfs, &gpc->pll_keep);
+	debugfs_create_x32("pll_auto", 0644, gpc->debugfs, &gpc->pll_auto);
+	debugfs_create_u32("pll_threshold_ms", 0644, gpc->debugfs,
+			   &gpc->pll_threshold_ms);
+	debugfs_create_u32("pll_measure", 0644, gpc->debugfs,
+			   &gpc->pll_measure);
+	debugfs_create_file("pll_stat", 0444, gpc->debugfs, gpc,
+			    &imx_gpcv2_pll_stat_fops);
+
+	/*
+	 * Writing 1 to flush_mode switches the suspend entry back to the
+	 * legacy double flush, so that the cost reported by flush_stat can
+	 * be compared between both sequences.
+	 */
+	debugfs_create_u32("flush_mode", 0644, gpc->debugfs,
+			   &gpc->pm->flush_mode);
+	debugfs_create_file("flush_stat", 0444, gpc->debugfs, gpc->pm,
+			    &imx_gpcv2_flush_stat_fops);
+
+	/*
+	 * With wake_measure set, each suspend times the wakeup from the
+	 * first instruction run by the woken core to the entry of the
+	 * handler of the wakeup interrupt.
+	 */
+	debugfs_create_u32("wake_measure", 0644, gpc->debugfs,
+			   &gpc->wake_measure);
+	debugfs_create_file("wake_latency", 0444, gpc->debugfs, gpc,
+			    &imx_gpcv2_wake_latency_fops);
+}
+
+/*
+ * GPC slot of each power domain ID of the fsl,imx7d-gpc binding, see
+ * Documentation/devicetree/bindings/power/fsl,imx7d-gpc.txt.
+ */
+static const enum gpcv2_slot imx_gpcv2_domain_slot[] = {
+	[IMX7_POWER_DOMAIN_MIPI_PHY] = MIPI_PHY,
+	[IMX7_POWER_DOMAIN_PCIE_PHY] = PCIE_PHY,
+	[IMX7_POWER_DOMAIN_USB_HSIC_PHY] = USB_HSIC_PHY,
+	[IMX7_POWER_DOMAIN_USB_OTG1_PHY] = USB_OTG1_PHY,
+	[IMX7_POWER_DOMAIN_USB_OTG2_PHY] = USB_OTG2_PHY,
+	[IMX7_POWER_DOMAIN_FAST_MEGA_MIX] = FAST_MEGA_MIX,
+};
+
+/*
+ * Return the GPC slot of the power domain @np is attached to. The GPC
+ * is either the provider itself, with the domain ID as the only cell,
+ * or an ancestor of a per-domain node whose reg is the domain ID.
+ * Unknown IDs are reported as -EINVAL.
+ */
+static int imx_gpcv2_node_to_slot(struct device_node *np)
+{
+	struct of_phandle_args args;
+	struct device_node *gpc_np;
+	u32 id;
+	int ret;
+
+	ret = of_parse_phandle_with_args(np, "power-domains",
+					 "#power-domain-cells", 0, &args);
+	if (ret)
+		return ret;
+
+	if (args.args_count == 1) {
+		gpc_np = of_node_get(args.np);
+		id = args.args[0];
+	} else {
+		gpc_np = of_get_parent(args.np);
+		ret = of_property_read_u32(args.np, "reg", &id);
+	}
+
+	while (gpc_np && !of_device_is_compatible(gpc_np, "fsl,imx7d-gpc"))
+		gpc_np = of_get_next_parent(gpc_np);
+	if (!gpc_np)
+		ret = -ENOENT;
+
+	of_node_put(gpc_np);
+	of_node_put(args.np);
+
+	if (ret)
+		return ret;
+	if (id >= ARRAY_SIZE(imx_gpcv2_domain_slot))
+		return -EINVAL;
+
+	return imx_gpcv2_domain_slot[id];
+}
+
+/* Whether any device in DT is attached to GPC domain @slot */
+static bool imx_gpcv2_dt_has_domain(enum gpcv2_slot slot)
+{
+	struct device_node *np;
+	int ret;
+
+	for_each_node_with_property(np, "power-domains") {
+		if (!of_device_is_available(np))
+			continue;
+		ret = imx_gpcv2_node_to_slot(np);
+		if (ret == slot) {
+			of_node_put(np);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Masks are collected for the Mega/Fast MIX at index 0 and for the PHY
+ * domains from index 1 on.
+ */
+#define GPC_MASK_DOMAINS	(1 + GPC_PHY_NUM)
+
+struct imx_gpcv2_mask_ctx {
+	struct generic_pm_domain *genpd[GPC_MASK_DOMAINS];
+	u32 *mask;
+	u32 num;
+};
+
+static int imx_gpcv2_slot_to_mask(int slot)
+{
+	if (slot == FAST_MEGA_MIX)
+		return 0;
+	if (slot >= MIPI_PHY && slot <= USB_HSIC_PHY)
+		return 1 + slot - MIPI_PHY;
+
+	return -EINVAL;
+}
+
+/* Mask indexes of the domains @np is attached to */
+static u32 imx_gpcv2_node_domains(struct device_node *np)
+{
+	int idx = imx_gpcv2_slot_to_mask(imx_gpcv2_node_to_slot(np));
+
+	return idx < 0 ? 0 : BIT(idx);
+}
+
+/*
+ * Mask indexes of the domains a device depends on: its own, and the
+ * ones of the PHYs it references, since a controller usually owns the
+ * interrupt while the power-domains entry sits on its PHY node.
+ */
+static u32 imx_gpcv2_dev_domains(struct device_node *np)
+{
+	static const char * const phy_props[] = { "fsl,usbphy", "usb-phy" };
+	struct of_phandle_args args;
+	struct device_node *phy;
+	u32 domains = imx_gpcv2_node_domains(np);
+	int i, j;
+
+	for (i = 0; !of_parse_phandle_with_args(np, "phys", "#phy-cells",
+						 i, &args); i++) {
+		domains |= imx_gpcv2_node_domains(args.np);
+		of_node_put(args.np);
+	}
+
+	for (j = 0; j < ARRAY_SIZE(phy_props); j++) {
+		for (i = 0; (phy = of_parse_phandle(np, phy_props[j], i));
+		     i++) {
+			domains |= imx_gpcv2_node_domains(phy);
+			of_node_put(phy);
+		}
+	}
+
+	return domains;
+}
+
+static int imx_gpcv2_add_dev_to_mask(struct device *dev, void *data)
+{
+	struct imx_gpcv2_mask_ctx *ctx = data;
+	struct of_phandle_args irq;
+	u32 domains, hwirq;
+	int i, idx;
+
+	if (!dev->driver || !dev->of_node)
+		return 0;
+
+	domains = imx_gpcv2_dev_domains(dev->of_node);
+	if (!domains)
+		return 0;
+
+	/*
+	 * A device attached to its own domain through power-domains has
+	 * the domain's genpd as its PM domain, the only kind DT attaches.
+	 */
+	idx = imx_gpcv2_slot_to_mask(imx_gpcv2_node_to_slot(dev->of_node));
+	if (idx >= 0 && dev->pm_domain)
+		ctx->genpd[idx] = container_of(dev->pm_domain,
+					       struct generic_pm_domain,
+					       domain);
+
+	for (i = 0; !of_irq_parse_one(dev->of_node, i, &irq); i++) {
+		/* only SPIs routed through the GPC can wake the system */
+		if (of_device_is_compatible(irq.np, "fsl,imx7d-gpc") &&
+		    irq.args_count >= 2 && irq.args[0] == 0) {
+			hwirq = irq.args[1];
+			for (idx = 0; idx < GPC_MASK_DOMAINS; idx++) {
+				if (!(domains & BIT(idx)) ||
+				    hwirq / 32 >= ctx->num)
+					continue;
+				ctx->mask[idx * ctx->num + hwirq / 32] |=
+					1 << (hwirq % 32);
+			}
+		}
+		of_node_put(irq.np);
+	}
+
+	return 0;
+}
+
+/*
+ * Collect the GPC interrupts of the devices bound to a driver in each
+ * power domain. A set bit means the interrupt needs the domain powered
+ * to wake the system up.
+ */
+static int imx_gpcv2_build_masks(struct imx_gpcv2 *gpc)
+{
+	struct imx_gpcv2_mask_ctx ctx = {
+		.num = gpc->mask_num,
+	};
+	size_t size = ctx.num * sizeof(u32);
+	unsigned long flags;
+	int i;
+
+	ctx.mask = kcalloc(ctx.num * GPC_MASK_DOMAINS, sizeof(u32),
+			   GFP_KERNEL);
+	if (!ctx.mask)
+		return -ENOMEM;
+
+	bus_for_each_dev(&platform_bus_type, NULL, &ctx,
+			 imx_gpcv2_add_dev_to_mask);
+
+	spin_lock_irqsave(&gpc->lock, flags);
+	if (gpc->mfmix_from_dt)
+		memcpy(gpc->mfmix_mask, ctx.mask, size);
+	for (i = 0; i < GPC_PHY_NUM; i++) {
+		memcpy(gpc->phy_mask[i], ctx.mask + (1 + i) * ctx.num, size);
+		gpc->phy_genpd[i] = ctx.genpd[1 + i];
+	}
+	spin_unlock_irqrestore(&gpc->lock, flags);
+
+	kfree(ctx.mask);
+	return 0;
+}
+
+static int imx_gpcv2_bus_notify(struct notifier_block *nb,
+				unsigned long action, void *data)
+{
+	struct imx_gpcv2 *gpc = container_of(nb, struct imx_gpcv2, bus_nb);
+
+	/*
+	 * Walking the bus here would make booting O(n^2) in the number of
+	 * devices, so only note the change and rebuild before suspend.
+	 */
+	switch (action) {
+	case BUS_NOTIFY_BOUND_DRIVER:
+	case BUS_NOTIFY_UNBOUND_DRIVER:
+		WRITE_ONCE(gpc->masks_stale, true);
+		break;
+	default:
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static void imx_gpcv2_wake_account(struct imx_gpcv2 *gpc,
+		const char *name, u64 ticks)
+{
+	struct imx_gpcv2_wake_stat *stat = NULL;
+	u32 rate = arch_timer_get_rate() ?: 1;
+	u32 us;
+	int i;
+
+	for (i = 0; i < GPC_WAKE_SRC_NUM; i++) {
+		stat = &gpc->wake_stat[i];
+		if (!stat->path[0] && !stat->path[1]) {
+			stat->hwirq = gpc->wake_hwirq;
+			strlcpy(stat->name, name ?: "?", sizeof(stat->name));
+			break;
+		}
+		if (stat->hwirq == gpc->wake_hwirq)
+			break;
+	}
+
+	if (i == GPC_WAKE_SRC_NUM) {
+		gpc->wake_unmatched++;
+		return;
+	}
+
+	us = min_t(u64, div_u64(ticks * USEC_PER_SEC, rate), U32_MAX);
+	stat->path[gpc->wake_path]++;
+	stat->max_us = max(stat->max_us, us);
+	stat->hist[min_t(int, fls(us), GPC_WAKE_HIST_NUM - 1)]++;
+}
+
+/*
+ * Controllers chained behind a GPC interrupt, such as the GPIO banks,
+ * never run irq_handler_entry for the GPC interrupt itself but only
+ * for their own child interrupts. Record their irq domains per GPC
+ * interrupt so that a wakeup through them can still be matched.
+ */
+static void imx_gpcv2_wake_chain_init(struct imx_gpcv2 *gpc)
+{
+	struct imx_gpcv2_wake_chain *chain;
+	struct of_phandle_args irq;
+	struct irq_domain *domain;
+	struct device_node *np;
+	int i;
+
+	gpc->wake_chain_num = 0;
+	for_each_node_with_property(np, "interrupt-controller") {
+		if (!of_device_is_available(np))
+			continue;
+		domain = irq_find_host(np);
+		if (!domain || domain == gpc->wake_domain)
+			continue;
+
+		for (i = 0; !of_irq_parse_one(np, i, &irq); i++) {
+			if (of_device_is_compatible(irq.np, "fsl,imx7d-gpc") &&
+			    irq.args_count >= 2 && irq.args[0] == 0 &&
+			    gpc->wake_chain_num < GPC_WAKE_CHAIN_NUM) {
+				chain = &gpc->wake_chain[gpc->wake_chain_num++];
+				chain->hwirq = irq.args[1];
+				chain->domain = domain;
+			}
+			of_node_put(irq.np);
+		}
+	}
+}
+
+/* irq_handler_entry probe, runs for every handler while measuring */
+static void imx_gpcv2_wake_irq_entry(void *data, int irq,
+		struct irqaction *action)
+{
+	struct imx_gpcv2 *gpc = data;
+	struct irq_data *d;
+	u64 now;
+
+	if (!gpc->wake_irq)
+		return;
+
+	/* the wake irq itself, or a child of the controller chained to it */
+	if (irq != gpc->wake_irq) {
+		d = irq_get_irq_data(irq);
+		if (!gpc->wake_child || !d || d->domain != gpc->wake_child)
+			return;
+	}
+
+	now = arch_counter_get_cntpct();
+	gpc->wake_irq = 0;
+	gpc->wake_child = NULL;
+
+	spin_lock(&gpc->lock);
+	imx_gpcv2_wake_account(gpc, action->name, now - gpc->wake_ticks);
+	spin_unlock(&gpc->lock);
+}
+
+static int imx_gpcv2_pm_begin(suspend_state_t state)
+{
+	struct imx_gpcv2 *gpc = gpcv2_instance;
+	struct imx_gpcv2_suspend *pm = gpc->pm;
+
+	/*
+	 * On failure the OCRAM code stays unset and suspend falls back to
+	 * cpu_do_idle(), so there is no point in retrying every time.
+	 */
+	if (!pm->ocram_ready) {
+		imx_gpcv2_suspend_init(pm);
+		pm->ocram_ready = true;
+	}
+
+	/* the L2 probe buffer is only needed once measuring is asked for */
+	if (gpc->l2_measure && !gpc->l2_probe_buf)
+		gpc->l2_probe_buf = kzalloc(L2_PROBE_SIZE, GFP_KERNEL);
+
+	if (gpc->wake_measure && gpc->wake_domain && !gpc->wake_probe) {
+		imx_gpcv2_wake_chain_init(gpc);
+		if (register_trace_irq_handler_entry(imx_gpcv2_wake_irq_entry,
+						     gpc))
+			pr_warn("%s: failed to hook irq entry!\n", __func__);
+		else
+			gpc->wake_probe = true;
+	}
+
+	return 0;
+}
+
+static int imx_gpcv2_pm_prepare_late(void)
+{
+	struct imx_gpcv2 *gpc = gpcv2_instance;
+
+	/* probing is blocked by now, no driver can be bound until resume */
+	if (READ_ONCE(gpc->masks_stale)) {
+		WRITE_ONCE(gpc->masks_stale, false);
+		if (imx_gpcv2_build_masks(gpc))
+			WRITE_ONCE(gpc->masks_stale, true);
+	}
+
+	gpc->next_wakeup_ms = imx_gpcv2_next_wakeup_ms();
+	gpc->pll_kept = imx_gpcv2_pll_policy(gpc);
+
+	return 0;
+}
+
+static void imx_gpcv2_pm_end(void)
+{
+	struct imx_gpcv2 *gpc = gpcv2_instance;
+
+	/* the wake handler has run by now, unless it never fired */
+	if (gpc->wake_irq) {
+		gpc->wake_irq = 0;
+		gpc->wake_child = NULL;
+		gpc->wake_unmatched++;
+	}
+
+	if (gpc->wake_probe) {
+		unregister_trace_irq_handler_entry(imx_gpcv2_wake_irq_entry,
+						   gpc);
+		gpc->wake_probe = false;
+	}
+}
+
 static const struct platform_suspend_ops imx_gpcv2_pm_ops = {
 	.enter = imx_gpcv2_pm_enter,
 	.valid = imx_gpcv2_pm_valid,
+	.begin = imx_gpcv2_pm_begin,
+	.end = imx_gpcv2_pm_end,
+	.prepare_late = imx_gpcv2_pm_prepare_late,
 };
 
 static int __init imx_gpcv2_pm_init(void)
 {
 	struct imx_gpcv2_suspend *pm;
+	struct device_node *np;
 	struct imx_gpcv2 *gpc;
-	int val, num;
+	int i, val, num;
 
 	pm = kzalloc(sizeof(struct imx_gpcv2_suspend), GFP_KERNEL);
 	if (!pm) {
@@ -830,8 +2195,6 @@ static int __init imx_gpcv2_pm_init(void)
 		return -ENOMEM;
 	}
 
-	imx_gpcv2_suspend_init(pm, &imx7d_pm_data_ddr3);
-
 	pm->lpm_env_setup = imx_gpcv2_lpm_env_setup;
 	pm->lpm_env_clean = imx_gpcv2_lpm_env_clean;
 
@@ -844,6 +2207,9 @@ static int __init imx_gpcv2_pm_init(void)
 	pm->set_slot = imx_gpcv2_lpm_slot_setup;
 	pm->set_act = imx_gpcv2_lpm_set_ack;
 
+	pm->mix_save = imx_gpcv2_lpm_mix_save;
+	pm->mix_restore = imx_gpcv2_lpm_mix_restore;
+
 	pm->standby = imx_gpcv2_lpm_standby;
 	pm->suspend = imx_gpcv2_lpm_suspend;
 
@@ -869,8 +2235,19 @@ static int __init imx_gpcv2_pm_init(void)
 	/* set SCU timing */
 	val = (0x59 << 10) | 0x5B | (0x51 << 20);
 	regmap_write(gpc->gpcv2, GPC_PGC_SCU_TIMING, val);
+	/* slots are set up read-modify-write, start from a clean table */
+	pm->clear_slots(gpc);
+
+	np = of_find_compatible_node(NULL, NULL, "fsl,imx7d-gpc");
+	gpc->wake_domain = irq_find_host(np);
+	of_node_put(np);
 
 	gpc->pm = pm;
+	gpc->l2_policy = GPC_L2_POWER_DOWN;
+	gpc->l2_threshold_ms = L2_AUTO_THRESHOLD_MS;
+	gpc->next_wakeup_ms = U32_MAX;
+	gpc->pll_auto = BIT(GPC_PLL_ENET) | BIT(GPC_PLL_AUDIO);
+	gpc->pll_threshold_ms = PLL_AUTO_THRESHOLD_MS;
 	gpc->get_wakeup_source = imx_gpcv2_get_wakeup_source;
 	gpcv2_instance = gpc;
 
@@ -886,7 +2263,8 @@ static int __init imx_gpcv2_pm_init(void)
 	 */
 
 	if (num)
-		gpc->wakeupmix_mask = kzalloc(sizeof(u32)*num*3, GFP_KERNEL);
+		gpc->wakeupmix_mask = kzalloc(sizeof(u32) * num *
+					      (3 + GPC_PHY_NUM), GFP_KERNEL);
 
 	if (!gpc->wakeupmix_mask)
 		goto error_exit;
@@ -898,12 +2276,35 @@ static int __init imx_gpcv2_pm_init(void)
 
 	gpc->lpsrmix_mask = gpc->wakeupmix_mask + num;
 	gpc->mfmix_mask = gpc->wakeupmix_mask + num*2;
+	for (i = 0; i < GPC_PHY_NUM; i++)
+		gpc->phy_mask[i] = gpc->wakeupmix_mask + num * (3 + i);
+
+	gpc->mask_num = num;
+	spin_lock_init(&gpc->lock);
+
+	/*
+	 * Mask the wakeup sources in M/F and PHY power domains. The masks
+	 * are built from the power-domains, PHY references and interrupts
+	 * of the devices bound to a driver, on the first suspend and again
+	 * after a driver has been bound or unbound. A PHY domain without
+	 * any known consumer interrupt is never powered down. Device trees
+	 * which do not attach any device to the M/F domain get the i.MX7D
+	 * defaults, with a warning since those cannot follow the board.
+	 */
+	gpc->mfmix_from_dt = imx_gpcv2_dt_has_domain(FAST_MEGA_MIX);
+	if (!gpc->mfmix_from_dt && num >= 4) {
+		pr_warn("%s: no device in IMX7_POWER_DOMAIN_FAST_MEGA_MIX, using the i.MX7D M/F wakeup sources\n",
+			__func__);
+		gpc->mfmix_mask[0] = 0x54010000;
+		gpc->mfmix_mask[1] = 0xC00;
+		gpc->mfmix_mask[2] = 0x0;
+		gpc->mfmix_mask[3] = 0x400010;
+	}
+	gpc->masks_stale = true;
+	gpc->bus_nb.notifier_call = imx_gpcv2_bus_notify;
+	bus_register_notifier(&platform_bus_type, &gpc->bus_nb);
 
-	/* Mask the wakeup sources in M/F power domain */
-	gpc->mfmix_mask[0] = 0x54010000;
-	gpc->mfmix_mask[1] = 0xC00;
-	gpc->mfmix_mask[2] = 0x0;
-	gpc->mfmix_mask[3] = 0x400010;
+	imx_gpcv2_debugfs_init(gpc);
 
 	suspend_set_ops(&imx_gpcv2_pm_ops);
 	return 0;
@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# Run suspend/resume cycles end to end, woken up by the RTC alarm, and
+# check that every one of them is reported as a success by the PM core.
+#
+# usage: suspend-test.sh [-n cycles] [-s seconds] [-m mem|standby] [-r rtc]
+#
+# Needs rtcwake (util-linux) and debugfs mounted on /sys/kernel/debug.
+# Exits non-zero if a cycle failed or did not complete.
+
+cycles=10
+seconds=2
+mode=mem
+rtc=rtc0
+
+while getopts "n:s:m:r:" opt; do
+	case $opt in
+	n) cycles=$OPTARG ;;
+	s) seconds=$OPTARG ;;
+	m) mode=$OPTARG ;;
+	r) rtc=$OPTARG ;;
+	*) echo "usage: $0 [-n cycles] [-s seconds] [-m mem|standby] [-r rtc]"
+	   exit 2 ;;
+	esac
+done
+
+stats=/sys/kernel/debug/suspend_stats
+gpcv2=/sys/kernel/debug/imx_gpcv2
+
+if [ ! -r $stats ]; then
+	echo "$stats not found, is debugfs mounted?"
+	exit 2
+fi
+
+if ! grep -qw $mode /sys/power/state; then
+	echo "$mode is not supported by this kernel"
+	exit 2
+fi
+
+count() {
+	awk -v key="$1:" '$1 == key { print $2; exit }' $stats
+}
+
+success=$(count success)
+fail=$(count fail)
+
+i=0
+while [ $i -lt $cycles ]; do
+	i=$((i + 1))
+	if ! rtcwake -d $rtc -m $mode -s $seconds > /dev/null; then
+		echo "cycle $i: rtcwake failed"
+		break
+	fi
+	echo "cycle $i: resumed"
+done
+
+done_ok=$(($(count success) - success))
+done_fail=$(($(count fail) - fail))
+
+echo "$mode: $done_ok of $cycles cycles succeeded, $done_fail failed"
+
+if [ -d $gpcv2 ]; then
+	for f in l2_stat pll_stat flush_stat wake_latency; do
+		[ -r $gpcv2/$f ] || continue
+		echo "--- $f"
+		cat $gpcv2/$f
+	done
+fi
+
+if [ $done_ok -ne $cycles ] || [ $done_fail -ne 0 ]; then
+	echo "FAIL"
+	grep -A 20 "failures:" $stats
+	exit 1
+fi
+
+echo "PASS"